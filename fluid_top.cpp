@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "headers/StateExport.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cout << "Usage: fluid-top NAME [PERIOD_MS]\n"; exit(EXIT_FAILURE);
+    }
+    int64_t period = 500;
+    if (argc > 2) {
+        auto [end, ec] = std::from_chars(argv[2], argv[2] + strlen(argv[2]), period);
+        if (ec != std::errc() || *end != '\0' || period < 0) {
+            std::cout << "Wrong period: " << argv[2] << "\n"; exit(EXIT_FAILURE);
+        }
+    }
+
+    std::unique_ptr<StateView> view;
+    try {
+        view = std::make_unique<StateView>(argv[1]);
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n"; exit(EXIT_FAILURE);
+    }
+    StateSnapshot snap;
+    do {
+        for (int64_t backoff = 1; !view->snapshot(snap); backoff = std::min<int64_t>(backoff * 2, 100)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+        }
+        if (period > 0) {std::cout << "\x1b[H\x1b[2J";}
+        std::cout << "tick " << snap.tick << ", moving " << snap.counters.moving_ticks << "/" << snap.counters.ticks << "\n";
+        for (size_t i = 0; i < PHASE_COUNT; i++) {
+            double avg = snap.counters.ticks ? double(snap.counters.ns[i]) / double(snap.counters.ticks) / 1000.0 : 0;
+            std::cout << PHASE_NAMES[i] << ": " << avg << " us/tick\n";
+        }
+        for (size_t x = 0; x < snap.height; ++x) {
+            std::cout.write(reinterpret_cast<const char*>(snap.field.data() + x * snap.width), (std::streamsize) snap.width);
+            std::cout << "\n";
+        }
+        std::cout.flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(period));
+    } while (period > 0);
+}
@@ -0,0 +1,26 @@
+#include <iostream>
+#include <string>
+
+#include "headers/FrameRecorder.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cout << "Usage: frame_reader FILE [TICK]\n"; exit(EXIT_FAILURE);
+    }
+    int64_t only = (argc > 2) ? std::stoll(argv[2]) : -1;
+
+    FrameReader reader(argv[1]);
+    std::cout << reader.N << " " << reader.M << "\n";
+
+    while (reader.next())
+    {
+        if (only >= 0 && reader.tick != only) {continue;}
+        std::cout << "tick " << reader.tick << (reader.keyframe ? " key" : "") << "\n";
+        for (size_t x = 0; x < reader.N; ++x) {
+            std::cout.write(reinterpret_cast<const char*>(reader.field.data() + x * reader.M), (std::streamsize) reader.M);
+            std::cout << "\n";
+        }
+        if (only >= 0) {break;}
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Simulator.h"
+#include "InfoF.h"
+#include "ParsingSettings.h"
+#include "FixedImpl.h"
+
+constexpr size_t CALIBRATION_TICKS = 200;
+constexpr size_t CALIBRATION_REPEATS = 3;
+
+struct CalibrationRun
+{
+    double seconds{};
+    std::vector<double> pressures;
+};
+
+inline double pressureDrift(const std::vector<double>& ref, const std::vector<double>& got)
+{
+    double diff = 0, norm = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        diff += (got[i] - ref[i]) * (got[i] - ref[i]);
+        norm += ref[i] * ref[i];
+    }
+    return (norm == 0) ? std::sqrt(diff) : std::sqrt(diff / norm);
+}
+
+template <typename Gen>
+CalibrationRun calibrateOnce(Gen gen, const InfoF& info, const SimSetts& setts)
+{
+    SimSetts quiet = setts;
+    quiet.output_filename.clear();
+    quiet.record_filename.clear();
+    quiet.export_name.clear();
+    quiet.quiet = true;
+
+    auto sim = gen();
+    sim->init(info, quiet);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CALIBRATION_TICKS; ++i) {
+        sim->nextTick();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return {std::chrono::duration<double>(end - start).count(), sim->pressures()};
+}
+
+// Every run starts from a fresh simulator with the same seed, so repeats
+// produce the same pressures and only the timing varies; the minimum is kept.
+template <typename Gen>
+CalibrationRun calibrate(Gen gen, const InfoF& info, const SimSetts& setts, size_t repeats = CALIBRATION_REPEATS)
+{
+    CalibrationRun best{};
+    for (size_t r = 0; r < repeats; r++)
+    {
+        auto run = calibrateOnce(gen, info, setts);
+        if (r == 0 || run.seconds < best.seconds) {
+            best = std::move(run);
+        }
+    }
+    return best;
+}
+
+template <typename Sims, typename Types>
+size_t autoSelectTypes(const Sims& sims, const Types& types, const InfoF& info, const SimSetts& setts)
+{
+    auto fits = [&](size_t i) {
+        auto [p, v, vf, n, m] = types[i];
+        return (n == info.height && m == info.width) || (n == 0 && m == 0);
+    };
+    auto describe = [&](size_t i) {
+        auto [p, v, vf, n, m] = types[i];
+        std::string size = n ? "S(" + std::to_string(n) + "," + std::to_string(m) + ")" : "dynamic";
+        return getNameFromType(p) + " " + getNameFromType(v) + " " + getNameFromType(vf) + " " + size;
+    };
+
+    size_t ref = types.size();
+    for (size_t i = 0; i < types.size() && ref == types.size(); i++) {
+        auto [p, v, vf, n, m] = types[i];
+        if (fits(i) && p == DOUBLE && v == DOUBLE && vf == DOUBLE) {ref = i;}
+    }
+    if (ref == types.size()) {
+        std::cout << "Auto types need DOUBLE in TYPES\n"; exit(EXIT_FAILURE);
+    }
+
+    auto overflows = fixedOverflowCount.load();
+
+    calibrate(sims[ref], info, setts, 1);
+    auto reference = calibrate(sims[ref], info, setts);
+    size_t best = ref;
+    double best_time = reference.seconds;
+    std::cerr << describe(ref) << ": " << reference.seconds << "s, reference\n";
+
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        if (i == ref || !fits(i)) {continue;}
+        auto run = calibrate(sims[i], info, setts);
+        double drift = pressureDrift(reference.pressures, run.pressures);
+        std::cerr << describe(i) << ": " << run.seconds << "s, drift " << drift << "\n";
+        if (drift <= setts.tolerance && run.seconds < best_time) {
+            best = i;
+            best_time = run.seconds;
+        }
+    }
+
+    std::cerr << "Selected " << describe(best) << "\n";
+    fixedOverflowCount.store(overflows);
+    return best;
+}
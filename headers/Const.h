@@ -1,3 +1,36 @@
 #pragma once
 #include <array>
-constexpr std::array<std::pair<int, int>, 4> deltas{{{-1, 0}, {1, 0}, {0, -1}, {0, 1}}};
\ No newline at end of file
+#include <utility>
+#include <type_traits>
+
+constexpr std::array<std::pair<int, int>, 4> deltas{{{-1, 0}, {1, 0}, {0, -1}, {0, 1}}};
+
+constexpr size_t deltaSlot(int dx, int dy)
+{
+    return ((dy&1)<<1) | (((dx&1)&((dx&2)>>1)) | ((dy&1)&((dy&2)>>1)));
+}
+
+constexpr size_t deltaIndex(int dx, int dy)
+{
+    size_t i = 0;
+    while (i < deltas.size() && deltas[i] != std::pair{dx, dy}) {i++;}
+    return i;
+}
+
+template <size_t d>
+struct Delta
+{
+    static constexpr int dx = deltas[d].first;
+    static constexpr int dy = deltas[d].second;
+    static constexpr size_t slot = deltaSlot(dx, dy);
+    static constexpr size_t opposite = deltaIndex(-dx, -dy);
+    static_assert(opposite < deltas.size());
+};
+
+template <typename F>
+constexpr void forDeltas(F&& f)
+{
+    [&]<size_t... d>(std::index_sequence<d...>) {
+        (f(std::integral_constant<size_t, d>{}), ...);
+    }(std::make_index_sequence<deltas.size()>{});
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Simulator.h"
+#include "InfoF.h"
+#include "ParsingSettings.h"
+#include "SharedMemory.h"
+
+using SimFactory = std::unique_ptr<Simulator>(*)();
+
+// Rows of one strip next to an edge that the strip above merges each tick.
+constexpr size_t MERGE_ROWS = 4;
+// Largest shift of a fluid's mean position against the serial run, as a
+// fraction of the field height or width, that --check-serial accepts.
+constexpr double SERIAL_TOLERANCE = 0.06;
+
+// Rows [begin, end) of the global field owned by one worker. Every worker
+// keeps the whole field. Forces, flow and writeback run on the owned rows;
+// the worker above each edge then takes `band` rows on both sides and
+// continues the flow searches across it. Move chains can close anywhere in
+// the field, so each tick the workers gather the rows and every one of them
+// runs the same move sweep with the same random stream.
+struct Strip
+{
+    size_t begin, end;
+    bool up, down;
+    size_t band;
+};
+
+std::vector<Strip> splitRows(size_t height, size_t workers);
+
+// Boundary rows and the gathered field live in one block that may sit in
+// the heap (threads) or in a POSIX shared-memory mapping (processes).
+struct HaloBoard
+{
+    std::atomic<uint32_t> arrived{0}, generation{0}, aborted{0}, stop{0};
+    uint32_t workers;
+    size_t row_bytes, height, state_bytes;
+
+    HaloBoard(uint32_t workers, size_t row_bytes, size_t height, size_t state_bytes);
+
+    static size_t bytes(size_t workers, size_t row_bytes, size_t height, size_t state_bytes);
+    char* slot(size_t worker, size_t side);
+    char* state(size_t row);
+    void wait();
+    void abort();
+};
+
+// shared(row) is the packed row in the gathered field. sync waits for every
+// worker; a stop requested by any of them is seen by all after the sync, so
+// they leave the tick loop together.
+struct HaloTransport
+{
+    virtual void exchange(std::vector<char>& up, std::vector<char>& down) = 0;
+    virtual char* shared(size_t row) = 0;
+    virtual void sync(bool stop) = 0;
+    virtual bool stopped() = 0;
+    virtual ~HaloTransport() = default;
+};
+
+struct BoardTransport final: HaloTransport
+{
+    HaloBoard* board;
+    size_t worker;
+
+    BoardTransport(HaloBoard* board, size_t worker): board(board), worker(worker) {}
+    void exchange(std::vector<char>& up, std::vector<char>& down) override;
+    char* shared(size_t row) override;
+    void sync(bool stop) override;
+    bool stopped() override;
+};
+
+bool sameCellCounts(const InfoF& info, const char* cells);
+
+void runWorker(SimFactory gen, const InfoF& info, const SimSetts& setts, const Strip& strip,
+               HaloTransport& halo);
+std::vector<char> runDecomposed(SimFactory gen, const InfoF& info, const SimSetts& setts);
+void compareWithSerial(SimFactory gen, const InfoF& info, const SimSetts& setts, const char* cells);
@@ -3,6 +3,10 @@
 #include <cstdint>
 #include "FixedImpl.h"
 
+#ifndef FIXED_OVERFLOW
+#define FIXED_OVERFLOW Wrap
+#endif
+
 template <size_t N>
 struct nSizeType;
 
@@ -12,4 +16,4 @@ template<> struct nSizeType<32> {using type = int32_t;};
 template<> struct nSizeType<64> {using type = int64_t;};
 
 template <size_t N, size_t K> requires (N >= K)
-using Fixed = FixedImpl<typename nSizeType<N>::type, K>;
+using Fixed = FixedImpl<typename nSizeType<N>::type, K, Overflow::FIXED_OVERFLOW>;
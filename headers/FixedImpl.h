@@ -1,18 +1,111 @@
 #pragma once
 
 #include <iostream>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <atomic>
 
-template <typename V, size_t K1>
+enum class Overflow {Wrap, Saturate, Trap};
+
+inline std::atomic<uint64_t> fixedOverflowCount{0};
+
+template <typename V, Overflow O>
+struct FixedArith
+{
+    static constexpr V lo = std::numeric_limits<V>::min();
+    static constexpr V hi = std::numeric_limits<V>::max();
+
+    static constexpr V resolve(bool overflow, V wrapped, bool up)
+    {
+        if constexpr (O == Overflow::Saturate) {
+            V sat = up ? hi : lo;
+            return overflow ? sat : wrapped;
+        } else {
+            if constexpr (O == Overflow::Trap) {
+                if (overflow) {fixedOverflowCount.fetch_add(1, std::memory_order_relaxed);}
+            }
+            return wrapped;
+        }
+    }
+
+    static constexpr V add(V a, int64_t b)
+    {
+        if constexpr (O == Overflow::Wrap) {
+            return V(a + b);
+        } else {
+            V res;
+            bool of = __builtin_add_overflow(a, b, &res);
+            return resolve(of, res, b > 0);
+        }
+    }
+
+    static constexpr V sub(V a, int64_t b)
+    {
+        if constexpr (O == Overflow::Wrap) {
+            return V(a - b);
+        } else {
+            V res;
+            bool of = __builtin_sub_overflow(a, b, &res);
+            return resolve(of, res, b < 0);
+        }
+    }
+
+    static constexpr V shl(int64_t x, size_t k)
+    {
+        if constexpr (O == Overflow::Wrap) {
+            return V(x << k);
+        } else {
+            V res;
+            bool of = __builtin_mul_overflow(x, int64_t(1) << k, &res);
+            return resolve(of, res, x > 0);
+        }
+    }
+
+    // Two's-complement wrap of an out-of-range double, the value Wrap mode
+    // would keep if the conversion were defined.
+    static V wrap(double f)
+    {
+        if (f != f) {return V(0);}
+        double period = std::ldexp(1.0, std::numeric_limits<V>::digits + 1);
+        return V((__int128) std::fmod(std::trunc(f), period));
+    }
+
+    static constexpr V narrow(__int128 x)
+    {
+        if constexpr (O == Overflow::Wrap) {
+            return V(x);
+        } else {
+            bool up = x > hi, down = x < lo;
+            return resolve(up || down, V(x), up);
+        }
+    }
+
+    static constexpr V scale(double f, size_t k)
+    {
+        double scaled = f * double(1ll << k);
+        if constexpr (O == Overflow::Wrap) {
+            return V(scaled);
+        } else {
+            bool up = !(scaled < double(hi)), down = scaled < double(lo);
+            return resolve(up || down, (up || down) ? wrap(scaled) : V(scaled), up);
+        }
+    }
+};
+
+template <typename V, size_t K1, Overflow O = Overflow::Wrap>
 struct FixedImpl
 {
-    template <typename V2, size_t K2>
-    explicit constexpr FixedImpl(FixedImpl<V2, K2> f): v((K1>=K2)?(((int64_t)f.v) << (K1-K2)):(f.v >> (K2-K1))) {}
+    using Arith = FixedArith<V, O>;
+
+    template <typename V2, size_t K2, Overflow O2>
+    explicit constexpr FixedImpl(FixedImpl<V2, K2, O2> f):
+            v(Arith::narrow((K1>=K2)?(((__int128)f.v) << (K1-K2)):(f.v >> (K2-K1)))) {}
 
-    explicit constexpr FixedImpl(int64_t v): v(v << K1) {}
-    explicit constexpr FixedImpl(float f): v(f * (1ll << K1)) {}
-    explicit constexpr FixedImpl(double f): v(f * (1ll << K1)) {}
+    explicit constexpr FixedImpl(int64_t v): v(Arith::shl(v, K1)) {}
+    explicit constexpr FixedImpl(float f): v(Arith::scale(f, K1)) {}
+    explicit constexpr FixedImpl(double f): v(Arith::scale(f, K1)) {}
     explicit constexpr FixedImpl(): v(0) {}
 
     static constexpr FixedImpl from_raw(int64_t x)
@@ -31,54 +124,59 @@ struct FixedImpl
     explicit constexpr operator double() const {return (double)v / ((double) (1ll << K1));}
 
     static const size_t k = K1;
+    static const Overflow overflow = O;
 };
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto operator+(FixedImpl<V1, K1> a, const FixedImpl<V2, K2>& b){
-    return FixedImpl<V1, K1>::from_raw((K1>K2) ? (a.v + (b.v << (K1-K2))) : (a.v + (b.v >> (K2-K1))));
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto operator+(FixedImpl<V1, K1, O1> a, const FixedImpl<V2, K2, O2>& b){
+    using Arith = typename FixedImpl<V1, K1, O1>::Arith;
+    return FixedImpl<V1, K1, O1>::from_raw((K1>K2) ? Arith::add(a.v, int64_t(b.v) << (K1-K2)) : Arith::add(a.v, b.v >> (K2-K1)));
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto operator-(FixedImpl<V1, K1> a, const FixedImpl<V2, K2>& b){
-    return FixedImpl<V1, K1>::from_raw((K1>K2) ? (a.v - (b.v << (K1-K2))) : (a.v - (b.v >> (K2-K1))));
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto operator-(FixedImpl<V1, K1, O1> a, const FixedImpl<V2, K2, O2>& b){
+    using Arith = typename FixedImpl<V1, K1, O1>::Arith;
+    return FixedImpl<V1, K1, O1>::from_raw((K1>K2) ? Arith::sub(a.v, int64_t(b.v) << (K1-K2)) : Arith::sub(a.v, b.v >> (K2-K1)));
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-FixedImpl<V1, K1> operator*(FixedImpl<V1, K1> a, const FixedImpl<V2, K2>& b){
-    return FixedImpl<V1, K1>(double(a) * double(b));
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+FixedImpl<V1, K1, O1> operator*(FixedImpl<V1, K1, O1> a, const FixedImpl<V2, K2, O2>& b){
+    using Arith = typename FixedImpl<V1, K1, O1>::Arith;
+    return FixedImpl<V1, K1, O1>::from_raw(Arith::narrow(((__int128) a.v * b.v) / ((__int128) 1 << K2)));
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto operator/(FixedImpl<V1, K1> a, const FixedImpl<V2, K2>& b){
-    return FixedImpl<V1, K1>(double(a) / double(b));
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto operator/(FixedImpl<V1, K1, O1> a, const FixedImpl<V2, K2, O2>& b){
+    return FixedImpl<V1, K1, O1>(double(a) / double(b));
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-FixedImpl<V1, K1>& operator+=(FixedImpl<V1, K1> &a, const FixedImpl<V2, K2>& b) {
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+FixedImpl<V1, K1, O1>& operator+=(FixedImpl<V1, K1, O1> &a, const FixedImpl<V2, K2, O2>& b) {
     return a = a + b;
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto& operator-=(FixedImpl<V1, K1> &a, const FixedImpl<V2, K2>& b) {
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto& operator-=(FixedImpl<V1, K1, O1> &a, const FixedImpl<V2, K2, O2>& b) {
     return a = a - b;
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto& operator*=(FixedImpl<V1, K1> &a, const FixedImpl<V2, K2>& b) {
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto& operator*=(FixedImpl<V1, K1, O1> &a, const FixedImpl<V2, K2, O2>& b) {
     return a = a * b;
 }
 
-template<typename V1, size_t K1, typename V2, size_t K2>
-auto& operator/=(FixedImpl<V1, K1> &a, const FixedImpl<V2, K2>& b) {
+template<typename V1, size_t K1, Overflow O1, typename V2, size_t K2, Overflow O2>
+auto& operator/=(FixedImpl<V1, K1, O1> &a, const FixedImpl<V2, K2, O2>& b) {
     return a = a / b;
 }
 
-template<typename V1, size_t K1>
-auto operator-(FixedImpl<V1, K1> x) {
-    return FixedImpl<V1, K1>::from_raw(-x.v);
+template<typename V1, size_t K1, Overflow O1>
+auto operator-(FixedImpl<V1, K1, O1> x) {
+    using Arith = typename FixedImpl<V1, K1, O1>::Arith;
+    return FixedImpl<V1, K1, O1>::from_raw(Arith::sub(V1(0), x.v));
 }
 
-template<typename V1, size_t K1>
-std::ostream &operator<<(std::ostream &out, const FixedImpl<V1, K1>& x) {
+template<typename V1, size_t K1, Overflow O1>
+std::ostream &operator<<(std::ostream &out, const FixedImpl<V1, K1, O1>& x) {
     return out << x.v / (double) (1ll << K1);
-}
\ No newline at end of file
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Searches stay inside rows [begin, end) and start from rows [from, to).
+struct FlowTile
+{
+    size_t begin, end;
+    int64_t ut;
+    size_t from, to;
+};
+
+// Worker threads that live as long as the simulator. run() splits rows
+// [begin, end) into tiles, releases the workers through the start barrier,
+// handles tile 0 on the calling thread and returns once every tile has
+// passed the done barrier. merge() then reruns the workers on bands that
+// straddle the tile edges, from the middle of one tile to the middle of the
+// next, starting searches only from the two rows next to each edge.
+struct FlowPool
+{
+    std::vector<FlowTile> tiles;
+    std::function<void(FlowTile&)> work;
+    std::barrier<> start, done;
+    std::atomic<bool> stop{false};
+    std::vector<std::jthread> workers;
+
+    FlowPool(size_t count, std::function<void(FlowTile&)> work);
+    ~FlowPool();
+
+    void run(size_t begin, size_t end, int64_t ut);
+    void merge(int64_t ut);
+    void dispatch();
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Frame container: header (magic, version, N, M, channels, keyframe period,
+// densities), then frames. 'K' frames hold the RLE field plus the enabled
+// channels, 'D' frames only the cells swap_between touched since the
+// previous frame. Channels are sampled at keyframes only. The header and
+// every keyframe go to disk immediately, so a killed run stays readable up
+// to its last keyframe.
+enum FrameChannel : uint8_t {CHANNEL_PRESSURE = 1, CHANNEL_VELOCITY = 2};
+
+constexpr char FRAME_MAGIC[4] = {'F', 'L', 'R', 'C'};
+constexpr uint32_t FRAME_VERSION = 1;
+constexpr size_t FRAME_BUFFER = 1 << 20;
+
+struct FrameRecorder
+{
+    size_t N, M;
+    uint8_t channels;
+    int64_t keyframe_every, tick = 0;
+    std::vector<uint32_t> dirty;
+    std::vector<char> buf;
+    std::ofstream out;
+
+    FrameRecorder(const std::string& filename, size_t N, size_t M, const double* densities,
+                  uint8_t channels, int64_t keyframe_every);
+    ~FrameRecorder();
+
+    bool wantsKeyframe() const {return tick % keyframe_every == 0;}
+    void markDirty(size_t x, size_t y) {dirty.push_back(x * M + y);}
+
+    void keyframe(const std::vector<uint8_t>& field, const std::vector<float>& p, const std::vector<float>& v);
+    template <typename F>
+    void delta(F symbolAt);
+
+    template <typename T>
+    void put(T value);
+    void flush();
+};
+
+template <typename T>
+void FrameRecorder::put(T value)
+{
+    auto bytes = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename F>
+void FrameRecorder::delta(F symbolAt)
+{
+    tick++;
+    std::ranges::sort(dirty);
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    put<char>('D'); put<int64_t>(tick - 1); put<uint32_t>(dirty.size());
+    for (auto cell : dirty) {
+        put<uint32_t>(cell);
+        put<uint8_t>(symbolAt(cell / M, cell % M));
+    }
+    dirty.clear();
+    if (buf.size() >= FRAME_BUFFER) {flush();}
+}
+
+struct FrameReader
+{
+    size_t N{}, M{};
+    uint8_t channels{};
+    int64_t keyframe_every{}, tick = -1;
+    double densities[256]{};
+    bool keyframe = false;
+    std::vector<uint8_t> field;
+    std::vector<float> p, v;
+    std::ifstream in;
+
+    explicit FrameReader(const std::string& filename);
+    bool next();
+
+    template <typename T>
+    T get();
+};
+
+template <typename T>
+T FrameReader::get()
+{
+    T value{};
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
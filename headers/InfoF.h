@@ -8,6 +8,7 @@ struct InfoF
 {
     size_t height{};
     size_t width{};
+    size_t owned_begin{}, owned_end{};
     double densities[256]{}, g{};
     std::vector<std::vector<uint8_t>> field;
 
@@ -15,6 +15,20 @@ struct SimSetts
     int p_type = 0, v_type = 0, vf_type = 0;
     std::string input_filename, output_filename;
     int64_t n_ticks;
+    int64_t ticks = 1000000;
+    bool auto_types = false;
+    double tolerance = 0.05;
+    std::string record_filename;
+    int64_t keyframe_every = 256;
+    uint8_t record_channels = 0;
+    size_t flow_threads = 1;
+    size_t workers = 1;
+    bool local_halo = false;
+    bool check_serial = false;
+    bool quiet = false;
+    std::string export_name;
+    int64_t export_every = 1;
 };
 
-SimSetts parseArgs(int argc, char* argv[]);
\ No newline at end of file
+SimSetts parseArgs(int argc, char* argv[]);
+std::string getNameFromType(int type);
\ No newline at end of file
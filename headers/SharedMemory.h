@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+struct ShmSegment
+{
+    std::string name;
+    size_t size;
+    void* memory;
+    bool owner;
+
+    ShmSegment(const std::string& name, size_t size);
+    explicit ShmSegment(const std::string& name);
+    ~ShmSegment();
+
+    void unlink();
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <csignal>
+
+// Set by SIGINT/SIGTERM. Tick loops stop at the next tick boundary so the
+// simulator's destructors flush the recording and unlink the export; a
+// second signal falls back to the default action.
+inline volatile std::sig_atomic_t stopRequested = 0;
+
+inline void installStopHandlers()
+{
+    auto handler = [](int sig) {
+        stopRequested = 1;
+        std::signal(sig, SIG_DFL);
+    };
+    std::signal(SIGINT, handler);
+    std::signal(SIGTERM, handler);
+}
@@ -4,12 +4,16 @@
 #include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <memory>
 
 #include "Const.h"
 #include "VectorField.h"
 #include "InfoF.h"
 #include "CusMatrix.h"
 #include "ParsingSettings.h"
+#include "FrameRecorder.h"
+#include "StateExport.h"
+#include "FlowPool.h"
 
 using std::tuple, std::pair, std::ofstream;
 
@@ -17,6 +21,21 @@ struct Simulator
 {
     virtual void nextTick() = 0;
     virtual void init(const InfoF& f, const SimSetts& setts) = 0;
+    virtual std::vector<double> pressures() = 0;
+    virtual size_t haloRowBytes(size_t width) = 0;
+    virtual void packRow(size_t x, char* out) = 0;
+    virtual void unpackRow(size_t x, const char* in) = 0;
+    virtual size_t haloDeltaBytes(size_t width) = 0;
+    virtual void packDelta(size_t x, const char* base, char* out) = 0;
+    virtual void applyDelta(size_t x, const char* in) = 0;
+    // The stages nextTick runs back to back; a decomposed worker calls them
+    // one by one and exchanges halo rows in between.
+    virtual void forcesPhase() = 0;
+    virtual void flowPhase() = 0;
+    virtual void writebackPhase() = 0;
+    virtual bool movePhase(size_t begin, size_t end) = 0;
+    virtual void outputPhase(bool moved) = 0;
+    virtual void mergeFlow(size_t begin, size_t end, size_t edge) = 0;
     virtual ~Simulator() = default;
 };
 
@@ -26,28 +45,55 @@ struct SimulatorImpl final: Simulator
     VectorField<vt, Nv, Mv> velocity{};
     VectorField<vft, Nv, Mv> velocity_flow{};
     CusMatrix<pt, Nv, Mv> p{}, old_p{};
-    CusMatrix<int64_t, Nv, Mv> last_use{}, dirs{};
+    CusMatrix<int64_t, Nv, Mv> last_use{};
+    CusMatrix<pt, Nv, Mv> inv_dirs{};
     CusMatrix<uint8_t, Nv, Mv> field{};
 
     size_t N = Nv, M = Mv;
+    size_t row_begin = 0, row_end = Nv;
+    bool quiet = false;
     pt rho[256]{};
     vt g{};
     int64_t UT = 0;
     std::mt19937 rnd;
     int64_t n_ticks{}, cur_tick{}; std::string out_name;
+    std::unique_ptr<FrameRecorder> recorder;
+    std::unique_ptr<StateExporter> exporter;
+    int64_t export_every = 1;
+    PhaseCounters counters;
+    std::unique_ptr<FlowPool> flow_pool;
 
     SimulatorImpl();
 
-    tuple<vft, bool, pair<int, int>> propagate_flow(int x, int y, vft lim);
+    bool blocked(int x, int y) {return x < (int) row_begin || x >= (int) row_end || field[x][y] == '#';}
+
+    tuple<vft, bool, pair<int, int>> propagate_flow(int x, int y, vft lim, FlowTile& tile);
+    bool flowPass(FlowTile& tile);
     void propagate_stop(int x, int y, bool force = false);
     vt move_prob(int x, int y);
     void swap_between(int x, int y, int nx, int ny);
     bool propagate_move(int x, int y, bool is_first);
     vt random01();
     void directionsInit();
+    void directionsUpdate(int x, int y);
     void nextTick() override;
     void init(const InfoF& f, const SimSetts& setts) override;
+    std::vector<double> pressures() override;
+    size_t haloRowBytes(size_t width) override;
+    void packRow(size_t x, char* out) override;
+    void unpackRow(size_t x, const char* in) override;
+    size_t haloDeltaBytes(size_t width) override;
+    void packDelta(size_t x, const char* base, char* out) override;
+    void applyDelta(size_t x, const char* in) override;
+    void forcesPhase() override;
+    void flowPhase() override;
+    void writebackPhase() override;
+    bool movePhase(size_t begin, size_t end) override;
+    void outputPhase(bool moved) override;
+    void mergeFlow(size_t begin, size_t end, size_t edge) override;
     void serialize();
+    void record();
+    void publish();
     ~SimulatorImpl() override = default;
 };
 
@@ -55,12 +101,14 @@ template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 void SimulatorImpl<pt, vt, vft, Nv, Mv>::init(const InfoF& f, const SimSetts& setts)
 {
     g = f.g; N = f.height; M = f.width;
+    row_begin = f.owned_begin; row_end = f.owned_end;
+    quiet = setts.quiet;
     for (int i = 0; i < 256; i++) {rho[i] = f.densities[i];}
 
     velocity.init(N, M);
     velocity_flow.init(N, M);
     p.init(N, M); old_p.init(N, M);
-    last_use.init(N, M); dirs.init(N, M);
+    last_use.init(N, M); inv_dirs.init(N, M);
     field.init(N, M);
 
     for (size_t i = 0; i < N; i++) {
@@ -73,6 +121,22 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::init(const InfoF& f, const SimSetts& se
     out_name = setts.output_filename;
 
     directionsInit();
+
+    if (!setts.record_filename.empty()) {
+        recorder = std::make_unique<FrameRecorder>(setts.record_filename, N, M, f.densities,
+                                                   setts.record_channels, setts.keyframe_every);
+    }
+    if (!setts.export_name.empty()) {
+        exporter = std::make_unique<StateExporter>(setts.export_name, N, M);
+        export_every = std::max<int64_t>(setts.export_every, 1);
+    }
+
+    size_t tiles = std::min(setts.flow_threads, (row_end - row_begin) / 4);
+    if (tiles > 1) {
+        flow_pool = std::make_unique<FlowPool>(tiles, [this](FlowTile& tile) {
+            while (flowPass(tile)) {}
+        });
+    }
 }
 
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
@@ -83,21 +147,36 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::directionsInit()
 {
     for (size_t x = 0; x < N; ++x) {
         for (size_t y = 0; y < M; ++y) {
-            if (field[x][y] == '#')
-                continue;
-            for (auto [dx, dy] : deltas) {
-                dirs[x][y] += (field[x + dx][y + dy] != '#');
-            }
+            directionsUpdate(x, y);
         }
     }
 }
 
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::directionsUpdate(int x, int y)
+{
+    if (field[x][y] == '#') {
+        inv_dirs[x][y] = pt();
+        return;
+    }
+    int cnt = 0;
+    forDeltas([&](auto d) {
+        using D = Delta<d>;
+        cnt += (field[x + D::dx][y + D::dy] != '#');
+    });
+    inv_dirs[x][y] = cnt ? pt(1.0 / cnt) : pt();
+}
+
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 void SimulatorImpl<pt, vt, vft, Nv, Mv>::swap_between(int x, int y, int nx, int ny)
 {
     std::swap(field[x][y], field[nx][ny]);
     std::swap(p[x][y], p[nx][ny]);
     std::swap(velocity.v[x][y], velocity.v[nx][ny]);
+    if (recorder) {
+        recorder->markDirty(x, y);
+        recorder->markDirty(nx, ny);
+    }
 }
 
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
@@ -112,39 +191,78 @@ vt SimulatorImpl<pt, vt, vft, Nv, Mv>::random01()
 }
 
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
-tuple<vft, bool, std::pair<int, int>> SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_flow(int x, int y, vft lim)
+tuple<vft, bool, std::pair<int, int>> SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_flow(int x, int y, vft lim, FlowTile& tile)
 {
-    last_use[x][y] = UT - 1;
+    last_use[x][y] = tile.ut - 1;
     vft ret{};
     for (auto [dx, dy] : deltas)
     {
         int nx = x + dx, ny = y + dy;
-        if (field[nx][ny] != '#' && last_use[nx][ny] < UT)
+        if (nx >= (int) tile.begin && nx < (int) tile.end && field[nx][ny] != '#' && last_use[nx][ny] < tile.ut)
         {
             auto cap = velocity.get(x, y, dx, dy);
             auto flow = velocity_flow.get(x, y, dx, dy);
             if (fabs(double(flow - vft(cap))) <= 0.0001) continue;
             auto vp = std::min(lim, vft(cap) - flow);
-            if (last_use[nx][ny] == UT - 1)
+            if (last_use[nx][ny] == tile.ut - 1)
             {
                 velocity_flow.add(x, y, dx, dy, vp);
-                last_use[x][y] = UT;
+                last_use[x][y] = tile.ut;
                 return {vp, 1, {nx, ny}};
             }
-            auto [t, prop, end] = propagate_flow(nx, ny, vp);
+            auto [t, prop, end] = propagate_flow(nx, ny, vp, tile);
             ret += t;
             if (prop)
             {
                 velocity_flow.add(x, y, dx, dy, t);
-                last_use[x][y] = UT;
+                last_use[x][y] = tile.ut;
                 return {t, end != std::pair(x, y), end};
             }
         }
     }
-    last_use[x][y] = UT;
+    last_use[x][y] = tile.ut;
     return {ret, false, {0, 0}};
 }
 
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+bool SimulatorImpl<pt, vt, vft, Nv, Mv>::flowPass(FlowTile& tile)
+{
+    tile.ut += 2;
+    bool prop = false;
+    for (size_t x = tile.from; x < tile.to; ++x) {
+        for (size_t y = 0; y < M; ++y) {
+            if (field[x][y] != '#' && last_use[x][y] != tile.ut) {
+                auto [t, local_prop, _] = propagate_flow(x, y, int64_t(1), tile);
+                if (t > int64_t(0)) {
+                    prop = true;
+                }
+            }
+        }
+    }
+    return prop;
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::flowPhase()
+{
+    if (flow_pool)
+    {
+        flow_pool->run(row_begin, row_end, UT);
+        for (auto& tile : flow_pool->tiles) {
+            UT = std::max(UT, tile.ut);
+        }
+        flow_pool->merge(UT);
+        for (auto& tile : flow_pool->tiles) {
+            UT = std::max(UT, tile.ut);
+        }
+        return;
+    }
+
+    FlowTile all{row_begin, row_end, UT, row_begin, row_end};
+    while (flowPass(all)) {}
+    UT = all.ut;
+}
+
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 void SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_stop(int x, int y, bool force)
 {
@@ -154,7 +272,7 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_stop(int x, int y, bool force
         for (auto [dx, dy] : deltas)
         {
             int nx = x + dx, ny = y + dy;
-            if (field[nx][ny] != '#' && last_use[nx][ny] < UT - 1 && velocity.get(x, y, dx, dy) > int64_t(0)) {
+            if (!blocked(nx, ny) && last_use[nx][ny] < UT - 1 && velocity.get(x, y, dx, dy) > int64_t(0)) {
                 stop = false;
                 break;
             }
@@ -165,7 +283,7 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_stop(int x, int y, bool force
     for (auto [dx, dy] : deltas)
     {
         int nx = x + dx, ny = y + dy;
-        if (field[nx][ny] == '#' || last_use[nx][ny] == UT || velocity.get(x, y, dx, dy) > int64_t(0)) {
+        if (blocked(nx, ny) || last_use[nx][ny] == UT || velocity.get(x, y, dx, dy) > int64_t(0)) {
             continue;
         }
         propagate_stop(nx, ny);
@@ -176,18 +294,18 @@ template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 vt SimulatorImpl<pt, vt, vft, Nv, Mv>::move_prob(int x, int y)
 {
     vt sum{};
-    for (auto [dx, dy] : deltas)
-    {
-        int nx = x + dx, ny = y + dy;
-        if (field[nx][ny] == '#' || last_use[nx][ny] == UT) {
-            continue;
+    forDeltas([&](auto d) {
+        using D = Delta<d>;
+        int nx = x + D::dx, ny = y + D::dy;
+        if (blocked(nx, ny) || last_use[nx][ny] == UT) {
+            return;
         }
-        auto v = velocity.get(x, y, dx, dy);
+        auto v = velocity.template get<d>(x, y);
         if (v < int64_t(0)) {
-            continue;
+            return;
         }
         sum += v;
-    }
+    });
     return sum;
 }
 
@@ -201,22 +319,21 @@ bool SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_move(int x, int y, bool is_fi
     do {
         std::array<vt, deltas.size()> tres;
         vt sum{};
-        for (size_t i = 0; i < deltas.size(); ++i)
-        {
-            auto [dx, dy] = deltas[i];
-            int nx = x + dx, ny = y + dy;
-            if (field[nx][ny] == '#' || last_use[nx][ny] == UT) {
-                tres[i] = sum;
-                continue;
+        forDeltas([&](auto d) {
+            using D = Delta<d>;
+            int nx = x + D::dx, ny = y + D::dy;
+            if (blocked(nx, ny) || last_use[nx][ny] == UT) {
+                tres[d] = sum;
+                return;
             }
-            auto v = velocity.get(x, y, dx, dy);
+            auto v = velocity.template get<d>(x, y);
             if (v < int64_t(0)) {
-                tres[i] = sum;
-                continue;
+                tres[d] = sum;
+                return;
             }
             sum += v;
-            tres[i] = sum;
-        }
+            tres[d] = sum;
+        });
 
         if (sum == int64_t(0)) {
             break;
@@ -228,7 +345,7 @@ bool SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_move(int x, int y, bool is_fi
         auto [dx, dy] = deltas[d];
         nx = x + dx;
         ny = y + dy;
-        assert(velocity.get(x, y, dx, dy) > int64_t(0) && field[nx][ny] != '#' && last_use[nx][ny] < UT);
+        assert(velocity.get(x, y, dx, dy) > int64_t(0) && !blocked(nx, ny) && last_use[nx][ny] < UT);
 
         ret = (last_use[nx][ny] == UT - 1 || propagate_move(nx, ny, false));
     } while (!ret);
@@ -238,7 +355,7 @@ bool SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_move(int x, int y, bool is_fi
     {
         auto [dx, dy] = deltas[i];
         int nx = x + dx, ny = y + dy;
-        if (field[nx][ny] != '#' && last_use[nx][ny] < UT - 1 && velocity.get(x, y, dx, dy) < int64_t(0)) {
+        if (!blocked(nx, ny) && last_use[nx][ny] < UT - 1 && velocity.get(x, y, dx, dy) < int64_t(0)) {
             propagate_stop(nx, ny);
         }
     }
@@ -254,105 +371,119 @@ bool SimulatorImpl<pt, vt, vft, Nv, Mv>::propagate_move(int x, int y, bool is_fi
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 void SimulatorImpl<pt, vt, vft, Nv, Mv>::nextTick()
 {
-    size_t x = 0;
-    while (x < N) {
-        size_t y = 0;
-        while (y < M) {
-            if (field[x][y] == '#') {
-                ++y;
-                continue;
-            }
-            if (field[x + 1][y] != '#') {
-                velocity.add(x, y, 1, 0, g);
+    PhaseClock clock(exporter != nullptr);
+    forcesPhase();
+    clock.lap(counters.ns[PHASE_FORCES]);
+
+    flowPhase();
+    clock.lap(counters.ns[PHASE_FLOW]);
+
+    writebackPhase();
+    clock.lap(counters.ns[PHASE_WRITEBACK]);
+
+    bool prop = movePhase(row_begin, row_end);
+    clock.lap(counters.ns[PHASE_MOVE]);
+
+    outputPhase(prop);
+    clock.lap(counters.ns[PHASE_OUTPUT]);
+
+    counters.ticks++;
+    counters.moving_ticks += prop;
+    if (exporter && counters.ticks % export_every == 0) {
+        publish();
+    }
+}
+
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::forcesPhase()
+{
+    auto gravity = [&](size_t x) {
+        for (size_t y = 0; y < M; ++y) {
+            if (field[x][y] != '#' && field[x + 1][y] != '#') {
+                velocity.template get<deltaIndex(1, 0)>(x, y) += g;
             }
-            ++y;
         }
-        ++x;
+    };
+    // The first owned row reads the gravity of the row above, so a strip adds
+    // it there and leaves the gravity of its own last row to the strip below.
+    if (row_begin > 0) {
+        gravity(row_begin - 1);
     }
-
-    old_p = p;
-    x = 0;
-    while (x < N) {
-        size_t y = 0;
-        while (y < M)
+    for (size_t x = (row_begin > 0) ? row_begin - 1 : 0; x < std::min(row_begin + 1, N); ++x) {
+        std::copy_n(&p[x][0], M, &old_p[x][0]);
+    }
+    for (size_t x = row_begin; x < row_end; ++x)
+    {
+        if (x + 1 < N) {
+            std::copy_n(&p[x + 1][0], M, &old_p[x + 1][0]);
+        }
+        if (x + 1 < row_end || row_end == N) {
+            gravity(x);
+        }
+        for (size_t y = 0; y < M; ++y)
         {
             if (field[x][y] == '#') continue;
-            for (auto [dx, dy] : deltas)
-            {
-                int nx = x + dx, ny = y + dy;
+            forDeltas([&](auto d) {
+                using D = Delta<d>;
+                int nx = x + D::dx, ny = y + D::dy;
                 if (field[nx][ny] != '#' && old_p[nx][ny] < old_p[x][y])
                 {
                     auto force = old_p[x][y] - old_p[nx][ny];
-                    auto& contr = velocity.get(nx, ny, -dx, -dy);
+                    auto& contr = velocity.template get<D::opposite>(nx, ny);
                     if (pt(contr) * rho[(int) field[nx][ny]] >= force)
                     {
                         contr -= vt(force / rho[(int) field[nx][ny]]);
-                        continue;
+                        return;
                     }
                     force -= pt(contr) * rho[(int) field[nx][ny]];
                     contr = int64_t(0);
-                    velocity.add(x, y, dx, dy, vt(force / rho[(int) field[x][y]]));
-                    p[x][y] -= force / pt(dirs[x][y]);
+                    velocity.template get<d>(x, y) += vt(force / rho[(int) field[x][y]]);
+                    p[x][y] -= force * inv_dirs[x][y];
                 }
-            }
-            ++y;
+            });
         }
-        ++x;
     }
+}
 
-    velocity_flow.clear();
-
-    bool prop;
-    do {
-        UT += 2;
-        prop = false;
-        size_t x = 0;
-        size_t y = 0;
-        while (x < N)
-        {
-            y = 0;
-            while (y < M)
-            {
-                if (field[x][y] != '#' && last_use[x][y] != UT) {
-                    auto [t, local_prop, _] = propagate_flow(x, y, int64_t(1));
-                    if (t > int64_t(0)) {
-                        prop = true;
-                    }
-                    ++y;
-                }
-            }
-            ++x;
-        }
-    } while (prop);
-
-    for (size_t x = 0; x < N; ++x) {
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::writebackPhase()
+{
+    for (size_t x = row_begin; x < row_end; ++x) {
         for (size_t y = 0; y < M; ++y) {
             if (field[x][y] == '#')
                 continue;
-            for (auto [dx, dy] : deltas)
-            {
-                auto old_v = velocity.get(x, y, dx, dy);
-                auto new_v = velocity_flow.get(x, y, dx, dy);
+            forDeltas([&](auto d) {
+                using D = Delta<d>;
+                auto old_v = velocity.template get<d>(x, y);
+                auto new_v = velocity_flow.template get<d>(x, y);
+                velocity_flow.template get<d>(x, y) = vft();
                 if (old_v > int64_t(0))
                 {
                     assert(vt(new_v) <= old_v);
-                    velocity.get(x, y, dx, dy) = vt(new_v);
+                    velocity.template get<d>(x, y) = vt(new_v);
                     auto force = pt(old_v - vt(new_v)) * rho[(int) field[x][y]];
                     if (field[x][y] == '.')
                         force *= pt(0.8);
-                    if (field[x + dx][y + dy] == '#') {
-                        p[x][y] += force / pt(dirs[x][y]);
+                    if (field[x + D::dx][y + D::dy] == '#') {
+                        p[x][y] += force * inv_dirs[x][y];
                     } else {
-                        p[x + dx][y + dy] += force / pt(dirs[x + dx][y + dy]);
+                        p[x + D::dx][y + D::dy] += force * inv_dirs[x + D::dx][y + D::dy];
                     }
                 }
-            }
+            });
         }
     }
+}
 
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+bool SimulatorImpl<pt, vt, vft, Nv, Mv>::movePhase(size_t begin, size_t end)
+{
     UT += 2;
-    prop = false;
-    for (size_t x = 0; x < N; ++x) {
+    auto owned = pair{row_begin, row_end};
+    row_begin = begin; row_end = end;
+    bool prop = false;
+    for (size_t x = begin; x < end; ++x) {
         for (size_t y = 0; y < M; ++y) {
             if (field[x][y] != '#' && last_use[x][y] != UT)
             {
@@ -365,15 +496,28 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::nextTick()
             }
         }
     }
+    std::tie(row_begin, row_end) = owned;
+    return prop;
+}
 
-    if (prop)
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::outputPhase(bool moved)
+{
+    if (moved && !quiet)
     {
+        std::string frame;
+        frame.reserve(N * (M + 1));
         for (size_t x = 0; x < N; ++x) {
             for (size_t y = 0; y < M; ++y) {
-                std::cout << field[x][y];
+                frame.push_back((char) field[x][y]);
             }
-            std::cout << "\n";
+            frame.push_back('\n');
         }
+        std::cout << frame;
+    }
+
+    if (recorder) {
+        record();
     }
 
     if (!out_name.empty() && (++cur_tick == n_ticks)) {
@@ -382,6 +526,155 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::nextTick()
     }
 }
 
+// Runs after every strip has finished its own flow. Searches start next to
+// the edge between two strips and may use any row of the band [begin, end),
+// which the calling worker holds for the duration.
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::mergeFlow(size_t begin, size_t end, size_t edge)
+{
+    FlowTile band{begin, end, UT, edge - 1, edge + 1};
+    while (flowPass(band)) {}
+    UT = band.ut;
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+std::vector<double> SimulatorImpl<pt, vt, vft, Nv, Mv>::pressures()
+{
+    std::vector<double> res;
+    res.reserve(N * M);
+    for (size_t x = 0; x < N; ++x) {
+        for (size_t y = 0; y < M; ++y) {
+            res.push_back(double(p[x][y]));
+        }
+    }
+    return res;
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+size_t SimulatorImpl<pt, vt, vft, Nv, Mv>::haloRowBytes(size_t width)
+{
+    return width * (sizeof(uint8_t) + sizeof(pt) + sizeof(velocity.v[0][0]) + sizeof(velocity_flow.v[0][0]));
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::packRow(size_t x, char* out)
+{
+    for (size_t y = 0; y < M; ++y) {
+        out[y] = (char) field[x][y];
+    }
+    out += M;
+    for (size_t y = 0; y < M; ++y, out += sizeof(pt)) {
+        memcpy(out, &p[x][y], sizeof(pt));
+    }
+    for (size_t y = 0; y < M; ++y, out += sizeof(velocity.v[x][y])) {
+        memcpy(out, &velocity.v[x][y], sizeof(velocity.v[x][y]));
+    }
+    for (size_t y = 0; y < M; ++y, out += sizeof(velocity_flow.v[x][y])) {
+        memcpy(out, &velocity_flow.v[x][y], sizeof(velocity_flow.v[x][y]));
+    }
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::unpackRow(size_t x, const char* in)
+{
+    for (size_t y = 0; y < M; ++y) {
+        field[x][y] = (uint8_t) in[y];
+    }
+    in += M;
+    for (size_t y = 0; y < M; ++y, in += sizeof(pt)) {
+        memcpy(&p[x][y], in, sizeof(pt));
+    }
+    for (size_t y = 0; y < M; ++y, in += sizeof(velocity.v[x][y])) {
+        memcpy(&velocity.v[x][y], in, sizeof(velocity.v[x][y]));
+    }
+    for (size_t y = 0; y < M; ++y, in += sizeof(velocity_flow.v[x][y])) {
+        memcpy(&velocity_flow.v[x][y], in, sizeof(velocity_flow.v[x][y]));
+    }
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+size_t SimulatorImpl<pt, vt, vft, Nv, Mv>::haloDeltaBytes(size_t width)
+{
+    return width * (sizeof(pt) + sizeof(velocity.v[0][0]));
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::packDelta(size_t x, const char* base, char* out)
+{
+    base += M;
+    for (size_t y = 0; y < M; ++y, base += sizeof(pt), out += sizeof(pt)) {
+        pt old;
+        memcpy(&old, base, sizeof(pt));
+        pt dp = p[x][y] - old;
+        memcpy(out, &dp, sizeof(pt));
+    }
+    for (size_t y = 0; y < M; ++y) {
+        for (size_t z = 0; z < deltas.size(); ++z, base += sizeof(vt), out += sizeof(vt)) {
+            vt old;
+            memcpy(&old, base, sizeof(vt));
+            vt dv = velocity.v[x][y][z] - old;
+            memcpy(out, &dv, sizeof(vt));
+        }
+    }
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::applyDelta(size_t x, const char* in)
+{
+    for (size_t y = 0; y < M; ++y, in += sizeof(pt)) {
+        pt dp;
+        memcpy(&dp, in, sizeof(pt));
+        p[x][y] += dp;
+    }
+    for (size_t y = 0; y < M; ++y) {
+        for (size_t z = 0; z < deltas.size(); ++z, in += sizeof(vt)) {
+            vt dv;
+            memcpy(&dv, in, sizeof(vt));
+            velocity.v[x][y][z] += dv;
+        }
+    }
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::record()
+{
+    if (!recorder->wantsKeyframe()) {
+        recorder->delta([&](size_t x, size_t y) {return field[x][y];});
+        return;
+    }
+
+    std::vector<uint8_t> cells;
+    std::vector<float> ps, vs;
+    cells.reserve(N * M);
+    for (size_t x = 0; x < N; ++x) {
+        for (size_t y = 0; y < M; ++y) {
+            cells.push_back(field[x][y]);
+            if (recorder->channels & CHANNEL_PRESSURE) {
+                ps.push_back(float(p[x][y]));
+            }
+            if (recorder->channels & CHANNEL_VELOCITY) {
+                forDeltas([&](auto d) {vs.push_back(float(velocity.template get<d>(x, y)));});
+            }
+        }
+    }
+    recorder->keyframe(cells, ps, vs);
+}
+
+template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
+void SimulatorImpl<pt, vt, vft, Nv, Mv>::publish()
+{
+    exporter->begin();
+    exporter->header->tick = counters.ticks;
+    exporter->header->counters = counters;
+    for (size_t x = 0; x < N; ++x) {
+        for (size_t y = 0; y < M; ++y) {
+            exporter->field[x * M + y] = field[x][y];
+            exporter->pressure[x * M + y] = float(p[x][y]);
+        }
+    }
+    exporter->end();
+}
+
 template <typename pt, typename vt, typename vft, size_t Nv, size_t Mv>
 void SimulatorImpl<pt, vt, vft, Nv, Mv>::serialize()
 {
@@ -412,4 +705,4 @@ void SimulatorImpl<pt, vt, vft, Nv, Mv>::serialize()
         x++;
     }
     out.close();
-}
\ No newline at end of file
+}
\ No newline at end of file
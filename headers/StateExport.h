@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SharedMemory.h"
+
+enum Phase {PHASE_FORCES, PHASE_FLOW, PHASE_WRITEBACK, PHASE_MOVE, PHASE_OUTPUT, PHASE_COUNT};
+
+constexpr const char* PHASE_NAMES[PHASE_COUNT] = {"forces", "flow", "writeback", "move", "output"};
+
+struct PhaseCounters
+{
+    uint64_t ticks = 0, moving_ticks = 0;
+    uint64_t ns[PHASE_COUNT]{};
+};
+
+// Reads the clock only when enabled; the counters are only published
+// through an export.
+struct PhaseClock
+{
+    bool enabled;
+    std::chrono::steady_clock::time_point last;
+
+    explicit PhaseClock(bool enabled): enabled(enabled)
+    {
+        if (enabled) {last = std::chrono::steady_clock::now();}
+    }
+
+    void lap(uint64_t& acc)
+    {
+        if (!enabled) {return;}
+        auto now = std::chrono::steady_clock::now();
+        acc += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+    }
+};
+
+// Segment layout: ExportHeader, then height*width field bytes, then
+// height*width float pressures. seq is odd while the simulator writes;
+// readers retry until they see the same even value before and after copying.
+// writer is the pid of the simulator, so a segment left behind by one that
+// was killed can be told apart from one in use.
+// Bump EXPORT_VERSION whenever this layout or PHASE_COUNT changes.
+struct ExportHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t height, width;
+    int64_t writer;
+    std::atomic<uint64_t> seq;
+    int64_t tick;
+    PhaseCounters counters;
+};
+
+constexpr char EXPORT_MAGIC[4] = {'F', 'L', 'S', 'M'};
+constexpr uint32_t EXPORT_VERSION = 2;
+
+struct StateExporter
+{
+    std::unique_ptr<ShmSegment> segment;
+    ExportHeader* header;
+    uint8_t* field;
+    float* pressure;
+
+    StateExporter(const std::string& name, size_t N, size_t M);
+
+    void begin();
+    void end();
+};
+
+struct StateSnapshot
+{
+    size_t height{}, width{};
+    int64_t tick{};
+    PhaseCounters counters;
+    std::vector<uint8_t> field;
+    std::vector<float> pressure;
+};
+
+struct StateView
+{
+    ShmSegment segment;
+    const ExportHeader* header;
+
+    explicit StateView(const std::string& name);
+    bool snapshot(StateSnapshot& out, size_t attempts = 1000) const;
+};
@@ -18,7 +18,13 @@ struct VectorField
 
     Type& get(int x, int y, int dx, int dy)
     {
-        return v[x][y][((dy&1)<<1) | (((dx&1)&((dx&2)>>1)) | ((dy&1)&((dy&2)>>1)))];
+        return v[x][y][deltaSlot(dx, dy)];
+    }
+
+    template <size_t d>
+    Type& get(int x, int y)
+    {
+        return v[x][y][Delta<d>::slot];
     }
 
     void clear();
@@ -42,4 +48,4 @@ template <typename Type, int Nv, int Mv>
 void VectorField<Type, Nv, Mv>::init(size_t Nvalue, size_t Mvalue)
 {
     N = Nvalue; M = Mvalue; v.init(Nvalue, Mvalue);
-}
\ No newline at end of file
+}
\ No newline at end of file
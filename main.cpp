@@ -3,6 +3,9 @@
 #include "headers/Simulator.h"
 #include "headers/ParsingSettings.h"
 #include "headers/TypeGen.h"
+#include "headers/Calibration.h"
+#include "headers/Decomposition.h"
+#include "headers/Shutdown.h"
 
 constexpr auto simulators = generateSimulators();
 constexpr auto types = generateTypes();
@@ -12,22 +15,55 @@ int main(int argc, char* argv[])
     SimSetts sets = parseArgs(argc, argv);
     InfoF info(sets.input_filename);
 
-    tuple need = {sets.p_type, sets.v_type, sets.vf_type, info.height, info.width};
-    auto index = std::find(types.begin(), types.end(), need) - types.begin();
-    if (index == types.size())
-    {
-        need = {sets.p_type, sets.v_type, sets.vf_type, 0, 0};
+    size_t index;
+    if (sets.auto_types) {
+        index = autoSelectTypes(simulators, types, info, sets);
+    } else {
+        tuple need = {sets.p_type, sets.v_type, sets.vf_type, info.height, info.width};
         index = std::find(types.begin(), types.end(), need) - types.begin();
+        if (index == types.size())
+        {
+            need = {sets.p_type, sets.v_type, sets.vf_type, 0, 0};
+            index = std::find(types.begin(), types.end(), need) - types.begin();
+        }
     }
 
     if (index == types.size()) {
         std::cout << "Simulator does not exist\n"; exit(EXIT_FAILURE);
     }
 
+    if (sets.workers > 1)
+    {
+        auto [p, v, vf, n, m] = types[index];
+        tuple dynamic = {p, v, vf, size_t(0), size_t(0)};
+        index = std::find(types.begin(), types.end(), dynamic) - types.begin();
+        if (index == types.size()) {
+            std::cout << "Simulator does not exist\n"; exit(EXIT_FAILURE);
+        }
+        try {
+            auto cells = runDecomposed(simulators[index], info, sets);
+            if (sets.check_serial && !stopRequested) {
+                compareWithSerial(simulators[index], info, sets, cells.data());
+            }
+        } catch (const std::exception& e) {
+            std::cout << e.what() << "\n"; exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
     auto sim = simulators[index]();
-    sim->init(info, sets);
+    try {
+        sim->init(info, sets);
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n"; exit(EXIT_FAILURE);
+    }
+    installStopHandlers();
 
-    for (size_t i = 0; i < 1000000; ++i) {
+    for (int64_t i = 0; i < sets.ticks && !stopRequested; ++i) {
         sim->nextTick();
     }
+
+    if (auto overflows = fixedOverflowCount.load()) {
+        std::cerr << "Fixed overflows: " << overflows << "\n";
+    }
 }
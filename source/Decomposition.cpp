@@ -0,0 +1,339 @@
+#include "../headers/Decomposition.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "../headers/Shutdown.h"
+
+std::vector<Strip> splitRows(size_t height, size_t workers)
+{
+    size_t band = std::max<size_t>(std::min(MERGE_ROWS, height / workers / 2), 1);
+    std::vector<Strip> strips;
+    for (size_t i = 0; i < workers; i++) {
+        strips.push_back({height * i / workers, height * (i + 1) / workers, i > 0, i + 1 < workers, band});
+    }
+    return strips;
+}
+
+HaloBoard::HaloBoard(uint32_t workers, size_t row_bytes, size_t height, size_t state_bytes):
+        workers(workers), row_bytes(row_bytes), height(height), state_bytes(state_bytes) {}
+
+size_t HaloBoard::bytes(size_t workers, size_t row_bytes, size_t height, size_t state_bytes)
+{
+    return sizeof(HaloBoard) + workers * 2 * row_bytes + height * state_bytes;
+}
+
+char* HaloBoard::slot(size_t worker, size_t side)
+{
+    return reinterpret_cast<char*>(this + 1) + (worker * 2 + side) * row_bytes;
+}
+
+char* HaloBoard::state(size_t row)
+{
+    return slot(workers, 0) + row * state_bytes;
+}
+
+void HaloBoard::wait()
+{
+    auto gen = generation.load(std::memory_order_acquire);
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == workers) {
+        arrived.store(0, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    while (generation.load(std::memory_order_acquire) == gen) {
+        if (aborted.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("Halo exchange aborted");
+        }
+        std::this_thread::yield();
+    }
+}
+
+void HaloBoard::abort()
+{
+    aborted.store(1, std::memory_order_relaxed);
+}
+
+bool sameCellCounts(const InfoF& info, const char* cells)
+{
+    int64_t counts[256]{};
+    for (size_t x = 0; x < info.height; ++x) {
+        for (size_t y = 0; y < info.width; ++y) {
+            counts[info.field[x][y]]++;
+            counts[(uint8_t) cells[x * info.width + y]]--;
+        }
+    }
+    return std::all_of(counts, counts + 256, [](int64_t c){return c == 0;});
+}
+
+
+void BoardTransport::exchange(std::vector<char>& up, std::vector<char>& down)
+{
+    if (!up.empty())   {std::copy(up.begin(), up.end(), board->slot(worker, 0));}
+    if (!down.empty()) {std::copy(down.begin(), down.end(), board->slot(worker, 1));}
+    board->wait();
+    if (!up.empty()) {
+        auto from = board->slot(worker - 1, 1);
+        std::copy(from, from + board->row_bytes, up.begin());
+    }
+    if (!down.empty()) {
+        auto from = board->slot(worker + 1, 0);
+        std::copy(from, from + board->row_bytes, down.begin());
+    }
+    board->wait();
+}
+
+char* BoardTransport::shared(size_t row)
+{
+    return board->state(row);
+}
+
+void BoardTransport::sync(bool stop)
+{
+    if (stop) {
+        board->stop.store(1, std::memory_order_relaxed);
+    }
+    board->wait();
+}
+
+bool BoardTransport::stopped()
+{
+    return board->stop.load(std::memory_order_relaxed);
+}
+
+
+// `settle` trades the deltas the forces or the writeback added to the rows
+// next to each edge; `lend` sends the first band rows to the strip above,
+// which continues the flow searches across the edge, and `give_back` returns
+// them. The top worker prints the frames.
+void runWorker(SimFactory gen, const InfoF& info, const SimSetts& setts, const Strip& strip,
+               HaloTransport& halo)
+{
+    SimSetts local = setts;
+    local.quiet = setts.quiet || strip.up;
+    InfoF owned = info;
+    owned.owned_begin = strip.begin;
+    owned.owned_end = strip.end;
+
+    auto sim = gen();
+    sim->init(owned, local);
+
+    size_t first = strip.begin, last = strip.end, band = strip.band;
+    size_t state = sim->haloRowBytes(info.width);
+    std::vector<char> up(strip.up ? band * state : 0), down(strip.down ? band * state : 0);
+    std::vector<char> base_up(state), base_down(state);
+
+    auto snapshot = [&] {
+        if (strip.up)   {sim->packRow(first - 1, base_up.data());}
+        if (strip.down) {sim->packRow(last, base_down.data());}
+    };
+    auto settle = [&] {
+        if (strip.up)   {sim->packDelta(first - 1, base_up.data(), up.data());}
+        if (strip.down) {sim->packDelta(last, base_down.data(), down.data());}
+        halo.exchange(up, down);
+        if (strip.up)   {sim->applyDelta(first, up.data());}
+        if (strip.down) {sim->applyDelta(last - 1, down.data());}
+    };
+    auto lend = [&] {
+        for (size_t k = 0; strip.up && k < band; k++) {sim->packRow(first + k, up.data() + k * state);}
+        halo.exchange(up, down);
+        for (size_t k = 0; strip.down && k < band; k++) {sim->unpackRow(last + k, down.data() + k * state);}
+    };
+    auto give_back = [&] {
+        for (size_t k = 0; strip.down && k < band; k++) {sim->packRow(last + k, down.data() + k * state);}
+        halo.exchange(up, down);
+        for (size_t k = 0; strip.up && k < band; k++) {sim->unpackRow(first + k, up.data() + k * state);}
+    };
+
+    for (int64_t i = 0; i < setts.ticks; ++i)
+    {
+        snapshot();
+        sim->forcesPhase();
+        settle();
+        sim->flowPhase();
+        lend();
+        if (strip.down) {sim->mergeFlow(last - band, last + band, last);}
+        give_back();
+
+        snapshot();
+        sim->writebackPhase();
+        settle();
+
+        for (size_t x = first; x < last; x++) {sim->packRow(x, halo.shared(x));}
+        halo.sync(stopRequested);
+        for (size_t x = 0; x < info.height; x++) {
+            if (x < first || x >= last) {sim->unpackRow(x, halo.shared(x));}
+        }
+        halo.sync(false);
+
+        sim->outputPhase(sim->movePhase(0, info.height));
+        if (halo.stopped()) {
+            break;
+        }
+    }
+    for (size_t x = first; x < last; x++) {sim->packRow(x, halo.shared(x));}
+    std::cout << std::flush;
+}
+
+std::vector<char> runDecomposed(SimFactory gen, const InfoF& info, const SimSetts& setts)
+{
+    size_t workers = std::max<size_t>(std::min(setts.workers, info.height / 2), 1);
+    auto strips = splitRows(info.height, workers);
+    size_t state = gen()->haloRowBytes(info.width), row = strips[0].band * state;
+    size_t size = HaloBoard::bytes(workers, row, info.height, state);
+
+    std::unique_ptr<ShmSegment> segment;
+    std::vector<char> heap;
+    void* memory;
+    if (setts.local_halo) {
+        heap.resize(size);
+        memory = heap.data();
+    } else {
+        segment = std::make_unique<ShmSegment>("/fluid-halo-" + std::to_string(getpid()), size);
+        segment->unlink();
+        memory = segment->memory;
+    }
+    auto* board = new (memory) HaloBoard(workers, row, info.height, state);
+    installStopHandlers();
+
+    if (setts.local_halo)
+    {
+        std::exception_ptr failure;
+        std::mutex failure_lock;
+        {
+            std::vector<std::jthread> threads;
+            for (size_t i = 0; i < workers; i++) {
+                threads.emplace_back([&, i] {
+                    try {
+                        BoardTransport halo(board, i);
+                        runWorker(gen, info, setts, strips[i], halo);
+                    } catch (...) {
+                        board->abort();
+                        std::lock_guard guard(failure_lock);
+                        if (!failure) {failure = std::current_exception();}
+                    }
+                });
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+    else
+    {
+        std::vector<pid_t> running;
+        bool failed = false, forwarded = false;
+        auto fail = [&] {
+            if (failed) {return;}
+            failed = true;
+            board->abort();
+            for (auto pid : running) {kill(pid, SIGKILL);}
+        };
+
+        for (size_t i = 0; i < workers && !failed; i++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                fail();
+                break;
+            }
+            if (pid == 0) {
+                try {
+                    BoardTransport halo(board, i);
+                    runWorker(gen, info, setts, strips[i], halo);
+                } catch (...) {
+                    board->abort();
+                    _exit(EXIT_FAILURE);
+                }
+                _exit(EXIT_SUCCESS);
+            }
+            running.push_back(pid);
+        }
+        // A signal sent to this process alone is passed on, so the workers
+        // stop after the same tick.
+        while (!running.empty()) {
+            int status;
+            pid_t pid = waitpid(-1, &status, WNOHANG);
+            if (pid < 0) {break;}
+            if (pid == 0) {
+                if (stopRequested && !forwarded) {
+                    forwarded = true;
+                    for (auto worker : running) {kill(worker, SIGTERM);}
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            auto it = std::find(running.begin(), running.end(), pid);
+            if (it == running.end()) {continue;}
+            running.erase(it);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                fail();
+            }
+        }
+        if (failed) {
+            throw std::runtime_error("Worker failed");
+        }
+    }
+
+    std::vector<char> cells(info.height * info.width);
+    for (size_t x = 0; x < info.height; ++x) {
+        std::copy_n(board->state(x), info.width, cells.data() + x * info.width);
+    }
+    if (!sameCellCounts(info, cells.data())) {
+        throw std::runtime_error("Decomposed run changed the fluid cell counts");
+    }
+    return cells;
+}
+
+// Runs the whole field on one simulator for the same number of ticks and
+// compares where each fluid ended up. Single cells differ between any two
+// runs, so only the mean row and column of every symbol are compared.
+void compareWithSerial(SimFactory gen, const InfoF& info, const SimSetts& setts, const char* cells)
+{
+    SimSetts local = setts;
+    local.quiet = true;
+    auto sim = gen();
+    sim->init(info, local);
+    for (int64_t i = 0; i < setts.ticks; ++i) {
+        sim->nextTick();
+    }
+    std::vector<char> serial(info.height * info.width);
+    std::vector<char> row(sim->haloRowBytes(info.width));
+    for (size_t x = 0; x < info.height; ++x) {
+        sim->packRow(x, row.data());
+        std::copy_n(row.data(), info.width, serial.data() + x * info.width);
+    }
+
+    auto centroids = [&](const char* field) {
+        std::vector<std::array<double, 3>> sums(256);
+        for (size_t x = 0; x < info.height; ++x) {
+            for (size_t y = 0; y < info.width; ++y) {
+                auto& sum = sums[(uint8_t) field[x * info.width + y]];
+                sum[0] += 1; sum[1] += x; sum[2] += y;
+            }
+        }
+        return sums;
+    };
+    auto ours = centroids(cells), theirs = centroids(serial.data());
+    for (size_t c = 0; c < 256; ++c)
+    {
+        if (c == '#' || ours[c][0] == 0) {
+            continue;
+        }
+        double dx = (ours[c][1] - theirs[c][1]) / ours[c][0], dy = (ours[c][2] - theirs[c][2]) / ours[c][0];
+        if (std::abs(dx) > SERIAL_TOLERANCE * info.height || std::abs(dy) > SERIAL_TOLERANCE * info.width) {
+            throw std::runtime_error("Decomposed run differs from the serial run: '" + std::string(1, (char) c)
+                                     + "' is off by " + std::to_string(dx) + " rows, "
+                                     + std::to_string(dy) + " columns");
+        }
+    }
+}
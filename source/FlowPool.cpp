@@ -0,0 +1,50 @@
+#include "../headers/FlowPool.h"
+
+FlowPool::FlowPool(size_t count, std::function<void(FlowTile&)> work):
+        tiles(count), work(std::move(work)), start((ptrdiff_t) count), done((ptrdiff_t) count)
+{
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back([this, i] {
+            while (true) {
+                start.arrive_and_wait();
+                if (stop.load(std::memory_order_relaxed)) {return;}
+                this->work(tiles[i]);
+                done.arrive_and_wait();
+            }
+        });
+    }
+}
+
+FlowPool::~FlowPool()
+{
+    stop.store(true, std::memory_order_relaxed);
+    start.arrive_and_wait();
+}
+
+void FlowPool::run(size_t begin, size_t end, int64_t ut)
+{
+    size_t count = tiles.size();
+    for (size_t i = 0; i < count; i++) {
+        size_t first = begin + (end - begin) * i / count, last = begin + (end - begin) * (i + 1) / count;
+        tiles[i] = {first, last, ut, first, last};
+    }
+    dispatch();
+}
+
+void FlowPool::merge(int64_t ut)
+{
+    size_t count = tiles.size();
+    for (size_t i = 0; i + 1 < count; i++) {
+        size_t edge = tiles[i].end;
+        tiles[i] = {(tiles[i].begin + edge) / 2, (edge + tiles[i + 1].end) / 2, ut, edge - 1, edge + 1};
+    }
+    tiles[count - 1] = {0, 0, ut, 0, 0};
+    dispatch();
+}
+
+void FlowPool::dispatch()
+{
+    start.arrive_and_wait();
+    work(tiles[0]);
+    done.arrive_and_wait();
+}
@@ -0,0 +1,131 @@
+#include "../headers/FrameRecorder.h"
+#include "../headers/Const.h"
+
+#include <cstring>
+#include <stdexcept>
+
+FrameRecorder::FrameRecorder(const std::string& filename, size_t N, size_t M, const double* densities,
+                             uint8_t channels, int64_t keyframe_every):
+        N(N), M(M), channels(channels), keyframe_every(std::max<int64_t>(keyframe_every, 1)),
+        out(filename, std::ios::binary)
+{
+    if (!out) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+    buf.reserve(FRAME_BUFFER + N * M * (1 + deltas.size()) * sizeof(float));
+
+    buf.insert(buf.end(), FRAME_MAGIC, FRAME_MAGIC + 4);
+    put<uint32_t>(FRAME_VERSION);
+    put<uint32_t>(N); put<uint32_t>(M);
+    put<uint8_t>(channels);
+    put<int64_t>(this->keyframe_every);
+
+    auto cnt = std::count_if(densities, densities + 256, [](double d){return d != 0;});
+    put<uint16_t>(cnt);
+    for (int i = 0; i < 256; i++) {
+        if (densities[i] == 0) {continue;}
+        put<uint8_t>(i); put<double>(densities[i]);
+    }
+    flush();
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    flush();
+}
+
+void FrameRecorder::keyframe(const std::vector<uint8_t>& field, const std::vector<float>& p, const std::vector<float>& v)
+{
+    put<char>('K'); put<int64_t>(tick++);
+
+    std::vector<std::pair<uint16_t, uint8_t>> runs;
+    for (auto symbol : field) {
+        if (!runs.empty() && runs.back().second == symbol && runs.back().first != UINT16_MAX) {
+            runs.back().first++;
+        } else {
+            runs.emplace_back(1, symbol);
+        }
+    }
+    put<uint32_t>(runs.size());
+    for (auto [len, symbol] : runs) {
+        put<uint16_t>(len); put<uint8_t>(symbol);
+    }
+
+    auto bytes = [&](const std::vector<float>& data) {
+        auto raw = reinterpret_cast<const char*>(data.data());
+        buf.insert(buf.end(), raw, raw + data.size() * sizeof(float));
+    };
+    if (channels & CHANNEL_PRESSURE) {bytes(p);}
+    if (channels & CHANNEL_VELOCITY) {bytes(v);}
+
+    dirty.clear();
+    flush();
+}
+
+void FrameRecorder::flush()
+{
+    out.write(buf.data(), (std::streamsize) buf.size());
+    out.flush();
+    buf.clear();
+}
+
+
+FrameReader::FrameReader(const std::string& filename): in(filename, std::ios::binary)
+{
+    if (!in) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+    char magic[4];
+    in.read(magic, 4);
+    if (!in || memcmp(magic, FRAME_MAGIC, 4) != 0 || get<uint32_t>() != FRAME_VERSION) {
+        throw std::runtime_error("Not a frame file: " + filename);
+    }
+    N = get<uint32_t>(); M = get<uint32_t>();
+    channels = get<uint8_t>();
+    keyframe_every = get<int64_t>();
+
+    auto cnt = get<uint16_t>();
+    for (size_t i = 0; i < cnt; i++) {
+        auto symbol = get<uint8_t>();
+        densities[symbol] = get<double>();
+    }
+    field.resize(N * M);
+}
+
+bool FrameReader::next()
+{
+    auto kind = get<char>();
+    if (!in) {return false;}
+    tick = get<int64_t>();
+    keyframe = (kind == 'K');
+
+    if (keyframe)
+    {
+        auto runs = get<uint32_t>();
+        size_t pos = 0;
+        for (size_t i = 0; i < runs; i++) {
+            auto len = get<uint16_t>();
+            auto symbol = get<uint8_t>();
+            if (pos + len > field.size()) {throw std::runtime_error("Corrupted keyframe");}
+            std::fill_n(field.begin() + pos, len, symbol);
+            pos += len;
+        }
+        auto floats = [&](std::vector<float>& data, size_t n) {
+            data.resize(n);
+            in.read(reinterpret_cast<char*>(data.data()), (std::streamsize) (n * sizeof(float)));
+        };
+        if (channels & CHANNEL_PRESSURE) {floats(p, N * M);}
+        if (channels & CHANNEL_VELOCITY) {floats(v, N * M * deltas.size());}
+    }
+    else
+    {
+        auto cnt = get<uint32_t>();
+        for (size_t i = 0; i < cnt; i++) {
+            auto cell = get<uint32_t>();
+            auto symbol = get<uint8_t>();
+            if (cell >= field.size()) {throw std::runtime_error("Corrupted delta");}
+            field[cell] = symbol;
+        }
+    }
+    return bool(in);
+}
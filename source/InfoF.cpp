@@ -30,5 +30,6 @@ void InfoF::readFromFile(const std::string& filename)
         getline(to_read, s);
         field.emplace_back(s.begin(), s.end());
     }
+    owned_begin = 0; owned_end = height;
     to_read.close();
 }
@@ -1,6 +1,7 @@
 #include <regex>
 #include <iostream>
 #include "../headers/ParsingSettings.h"
+#include "../headers/FrameRecorder.h"
 
 #define DOUBLE_T "DOUBLE"
 #define FLOAT_T  "FLOAT"
@@ -9,6 +10,7 @@
 #define STRING_TYPES "\"?(" FAST_FIXED_T "|" FIXED_T "|" FLOAT_T "|" DOUBLE_T ")\"?"
 #define STRING_FILE_PATH "(((?:(([^\\/\\s]*)|(\".*\"))\\/)*)((\".*\")|([^\\s]*)))"
 #define NUMBER "([0-9]+)"
+#define REAL "([0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?)(?=\\s)"
 
 using std::string, std::regex, std::smatch, std::regex_search, std::cout, std::stoi;
 
@@ -50,6 +52,17 @@ int getTypeFromName(std::string& name)
 }
 
 
+std::string getNameFromType(int type)
+{
+    if (type == FLOAT)  {return FLOAT_T;}
+    if (type == DOUBLE) {return DOUBLE_T;}
+    if (type < 10000) {
+        return "FIXED(" + std::to_string(type/100) + "," + std::to_string(type%100) + ")";
+    }
+    return "FAST_FIXED(" + std::to_string(type/10000) + "," + std::to_string(type%10000) + ")";
+}
+
+
 SimSetts parseSettings(const int argc, char* argv[])
 {
     std::string all;
@@ -58,7 +71,7 @@ SimSetts parseSettings(const int argc, char* argv[])
     }
 
     SimSetts st{};
-    std::string p_type_s, v_type_s, vf_type_s, in_filename, out_filename, ticks;
+    std::string p_type_s, v_type_s, vf_type_s, in_filename, out_filename, ticks, run_ticks, tolerance, record_filename, keyframe, threads, workers, export_name, export_every;
     int group = 1;
 
     parsing("--p-type="   STRING_TYPES, &p_type_s, all, &group, 1);
@@ -67,9 +80,36 @@ SimSetts parseSettings(const int argc, char* argv[])
     parsing("--in-file="  STRING_FILE_PATH, &in_filename, all, &group, 1);
     parsing("--out-file=" STRING_FILE_PATH, &out_filename, all, &group, 1);
     parsing("--n-ticks="  NUMBER, &ticks, all, &group, 1);
+    parsing("--ticks="    NUMBER, &run_ticks, all, &group, 1);
+    if (!parsing("--tolerance=" REAL, &tolerance, all, &group, 1) && all.find("--tolerance=") != string::npos) {
+        cout << "Wrong tolerance\n"; exit(EXIT_FAILURE);
+    }
+    st.auto_types = parsing("--auto-types", nullptr, all, &group, 0);
+    parsing("--record=" STRING_FILE_PATH, &record_filename, all, &group, 1);
+    parsing("--keyframe-every=" NUMBER, &keyframe, all, &group, 1);
+    parsing("--flow-threads=" NUMBER, &threads, all, &group, 1);
+    parsing("--workers=" NUMBER, &workers, all, &group, 1);
+    st.local_halo = parsing("--halo=local", nullptr, all, &group, 0);
+    st.check_serial = parsing("--check-serial", nullptr, all, &group, 0);
+    st.quiet = parsing("--quiet", nullptr, all, &group, 0);
+    parsing("--export=" STRING_FILE_PATH, &export_name, all, &group, 1);
+    parsing("--export-every=" NUMBER, &export_every, all, &group, 1);
+    st.record_channels |= parsing("--record-p", nullptr, all, &group, 0) ? CHANNEL_PRESSURE : 0;
+    st.record_channels |= parsing("--record-v", nullptr, all, &group, 0) ? CHANNEL_VELOCITY : 0;
     st.p_type  = getTypeFromName(p_type_s);    st.v_type  = getTypeFromName(v_type_s);
     st.vf_type = getTypeFromName(vf_type_s);
     st.input_filename =  in_filename;    st.output_filename = out_filename;
+    if (!tolerance.empty()) {st.tolerance = std::stod(tolerance);}
+    st.record_filename = record_filename;
+    if (!keyframe.empty()) {st.keyframe_every = std::stoll(keyframe);}
+    if (!threads.empty()) {st.flow_threads = std::stoul(threads);}
+    if (!workers.empty()) {st.workers = std::stoul(workers);}
+    st.export_name = export_name;
+    if (!export_every.empty()) {st.export_every = std::stoll(export_every);}
+    if (!run_ticks.empty()) {st.ticks = std::stoll(run_ticks);}
+    if (st.workers > 1 && (!st.output_filename.empty() || !st.record_filename.empty() || !st.export_name.empty())) {
+        cout << "--out-file, --record and --export need a single simulator, drop --workers\n"; exit(EXIT_FAILURE);
+    }
 
     return st;
 }
\ No newline at end of file
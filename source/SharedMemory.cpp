@@ -0,0 +1,60 @@
+#include "../headers/SharedMemory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+
+ShmSegment::ShmSegment(const std::string& name, size_t size): name(name), size(size), owner(true)
+{
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        throw std::runtime_error("Shared memory already exists: " + name);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Unable to create shared memory: " + name);
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+        close(fd); shm_unlink(name.c_str());
+        throw std::runtime_error("Unable to resize shared memory: " + name);
+    }
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Unable to map shared memory: " + name);
+    }
+}
+
+ShmSegment::ShmSegment(const std::string& name): name(name), owner(false)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open shared memory: " + name);
+    }
+    struct stat st{};
+    fstat(fd, &st);
+    size = st.st_size;
+    memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Unable to map shared memory: " + name);
+    }
+}
+
+ShmSegment::~ShmSegment()
+{
+    munmap(memory, size);
+    unlink();
+}
+
+void ShmSegment::unlink()
+{
+    if (owner) {
+        shm_unlink(name.c_str());
+        owner = false;
+    }
+}
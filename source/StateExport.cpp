@@ -0,0 +1,102 @@
+#include "../headers/StateExport.h"
+
+#include <sys/mman.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+static size_t exportBytes(size_t N, size_t M)
+{
+    return sizeof(ExportHeader) + N * M * (sizeof(uint8_t) + sizeof(float)) + alignof(float);
+}
+
+// A segment whose writer no longer runs was left by a killed simulator;
+// remove it so the name can be exported again.
+static void reclaimStale(const std::string& name)
+{
+    int64_t writer;
+    try {
+        StateView old(name);
+        writer = old.header->writer;
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    if (writer > 0 && kill((pid_t) writer, 0) != 0 && errno == ESRCH) {
+        shm_unlink(name.c_str());
+    }
+}
+
+StateExporter::StateExporter(const std::string& name, size_t N, size_t M)
+{
+    reclaimStale(name);
+    segment = std::make_unique<ShmSegment>(name, exportBytes(N, M));
+
+    header = new (segment->memory) ExportHeader{};
+    memcpy(header->magic, EXPORT_MAGIC, 4);
+    header->version = EXPORT_VERSION;
+    header->height = N; header->width = M;
+    header->writer = getpid();
+
+    field = reinterpret_cast<uint8_t*>(header + 1);
+    auto addr = reinterpret_cast<uintptr_t>(field + N * M);
+    pressure = reinterpret_cast<float*>((addr + alignof(float) - 1) / alignof(float) * alignof(float));
+}
+
+void StateExporter::begin()
+{
+    header->seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void StateExporter::end()
+{
+    header->seq.fetch_add(1, std::memory_order_release);
+}
+
+
+StateView::StateView(const std::string& name): segment(name)
+{
+    header = static_cast<const ExportHeader*>(segment.memory);
+    if (segment.size < sizeof(ExportHeader) || memcmp(header->magic, EXPORT_MAGIC, 4) != 0) {
+        throw std::runtime_error("Not a simulator export: " + name);
+    }
+    if (header->version != EXPORT_VERSION) {
+        throw std::runtime_error("Unsupported export version " + std::to_string(header->version) + ": " + name);
+    }
+    if (segment.size < exportBytes(header->height, header->width)) {
+        throw std::runtime_error("Export is smaller than its header claims: " + name);
+    }
+}
+
+bool StateView::snapshot(StateSnapshot& out, size_t attempts) const
+{
+    size_t N = header->height, M = header->width;
+    auto field = reinterpret_cast<const uint8_t*>(header + 1);
+    auto addr = reinterpret_cast<uintptr_t>(field + N * M);
+    auto pressure = reinterpret_cast<const float*>((addr + alignof(float) - 1) / alignof(float) * alignof(float));
+
+    out.height = N; out.width = M;
+    out.field.resize(N * M); out.pressure.resize(N * M);
+    for (size_t i = 0; i < attempts; i++)
+    {
+        auto before = header->seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        out.tick = header->tick;
+        out.counters = header->counters;
+        memcpy(out.field.data(), field, N * M);
+        memcpy(out.pressure.data(), pressure, N * M * sizeof(float));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->seq.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}